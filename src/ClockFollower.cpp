@@ -0,0 +1,119 @@
+#include "ClockFollower.hpp"
+
+
+// Multiplier reciprocals so no division is needed to subdivide the period
+static const float invMult[MAX_CLOCK_MULT+1] = {1.f, 1.f, 1.f/2, 1.f/3, 1.f/4};
+
+// Limit on the sample counters, well below where adding 1 to a float stalls
+static const float maxCount = (float)(1 << 22);
+
+ClockFollower::ClockFollower() :
+    mult_{1},
+    gateWidth_{0.5f}
+{
+    reset(0.f);
+}
+
+// Only the timing is reset. The trigger is seeded from the input so a clock
+// that is already high does not look like a new edge.
+void ClockFollower::reset(float in)
+{
+    high_ = (in >= 1.f);
+    lastIn_ = in;
+    elapsed_ = 0.f;
+    period_ = 0.f;
+    subPeriod_ = 0.f;
+    gateLength_ = 0.f;
+    counter_ = 0.f;
+    ticksLeft_ = 0;
+    gate_ = false;
+    hasEdge_ = false;
+    resynced_ = false;
+}
+
+void ClockFollower::setMultiplier(unsigned mult)
+{
+    mult_ = mult < 1 ? 1 : (mult > MAX_CLOCK_MULT ? MAX_CLOCK_MULT : mult);
+}
+
+void ClockFollower::setGateWidth(float width)
+{
+    gateWidth_ = width < 0.f ? 0.f : (width > 1.f ? 1.f : width);
+}
+
+// This function is called by the audio thread.
+bool ClockFollower::process(float in)
+{
+    bool tick = false;
+    bool edge = false;
+    float offset = 0.f;
+
+    if (elapsed_ < maxCount) elapsed_ += 1.f;
+    if (counter_ < maxCount) counter_ += 1.f;
+
+    if (high_)
+    {
+        if (in <= 0.f)
+            high_ = false;
+    }
+    else if (in >= 1.f)
+    {
+        high_ = true;
+        edge = true;
+        // Linear interpolation of where the input crossed the threshold.
+        // lastIn_ < 1 <= in, so this is always in (0, 1].
+        float frac = (1.f - lastIn_) / (in - lastIn_);
+        // How long ago the edge happened
+        offset = 1.f - frac;
+    }
+    lastIn_ = in;
+
+    if (edge)
+    {
+        // The first edge, or the first after the clock has stopped, has no 
+        // previous edge to measure from. Only resync the phase to it. 
+        // After a resync the next interval is always measured, so a big 
+        // slow down is still picked up.
+        bool resync = !hasEdge_ || (!resynced_ && elapsed_ > 2.f * period_);
+
+        if (!resync)
+        {
+            float measured = elapsed_ - offset;
+
+            // Averaging filter to smooth jitter. Anything more than 1/8 of 
+            // the period out is a tempo change, so jump straight to it and 
+            // the subdivisions are right from the next beat.
+            float error = measured - period_;
+            if (period_ <= 0.f || error > 0.125f * period_ || error < -0.125f * period_)
+                period_ = measured;
+            else
+                period_ += 0.25f * error;
+        }
+        hasEdge_ = true;
+        resynced_ = resync;
+
+        subPeriod_ = period_ * invMult[mult_];
+        gateLength_ = subPeriod_ * gateWidth_;
+
+        elapsed_ = offset;
+        counter_ = offset;
+        // No subdivisions until the period is known
+        ticksLeft_ = (period_ > 0.f) ? mult_ - 1 : 0;
+        tick = true;
+    }
+    else if (ticksLeft_ > 0 && counter_ >= subPeriod_)
+    {
+        // Internal subdivision
+        counter_ -= subPeriod_;
+        ticksLeft_--;
+        tick = true;
+    }
+
+    // Until two edges have been measured the gate follows the input
+    if (period_ <= 0.f)
+        gate_ = high_;
+    else
+        gate_ = counter_ < gateLength_;
+
+    return tick;
+}
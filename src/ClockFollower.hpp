@@ -0,0 +1,47 @@
+#pragma once
+
+
+#define MAX_CLOCK_MULT 4
+
+// Follows an external clock. Rising edges are timestamped to a fraction of a 
+// sample and the clock period is tracked with an averaging filter, so the
+// clock can be multiplied and gate widths locked to its tempo.
+// All divisions happen once per edge; process() is a counter per sample.
+class ClockFollower
+{
+private:
+    // Schmitt trigger state, using the same thresholds as dsp::SchmittTrigger
+    bool high_;
+    float lastIn_;
+
+    // Times are in samples
+    float elapsed_;       // since the last edge
+    float period_;        // averaged external period, 0 until known
+    float subPeriod_;     // period_ divided by the multiplier
+    float gateLength_;    // subPeriod_ scaled by the gate width
+    float counter_;       // since the last tick
+    unsigned ticksLeft_;  // remaining ticks before the next edge
+    bool gate_;
+    bool hasEdge_;        // an edge has been seen since reset
+    bool resynced_;       // the last edge only resynced the phase
+
+    unsigned mult_;
+    float gateWidth_;
+
+public:
+    ClockFollower();
+
+    // Restart tempo tracking. in is the current clock input voltage.
+    void reset(float in);
+
+    // 1 to MAX_CLOCK_MULT ticks per external clock
+    void setMultiplier(unsigned mult);
+    // Gate high time as a fraction of the ticks' period
+    void setGateWidth(float width);
+
+    // Call once per sample with the clock input voltage. 
+    // Returns true when a new tick should be generated
+    bool process(float in);
+
+    bool gate() const { return gate_; }
+};
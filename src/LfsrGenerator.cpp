@@ -1,4 +1,6 @@
 #include "NoteGenerator.hpp"
+#include "ClockFollower.hpp"
+#include "RhythmGenerator.hpp"
 #include "plugin.hpp"
 #include <algorithm>
 
@@ -12,6 +14,15 @@ struct LfsrGenerator : Module {
         MAJMIN_PARAM,
         SHARPFLAT_PARAM,
         LEVELQUANTISE_PARAM,
+        CHORD_PARAM,
+        INVERSION_PARAM,
+        SPREAD_PARAM,
+        CLOCKMULT_PARAM,
+        GATEWIDTH_PARAM,
+        RHYTHM_PARAM,
+        STEPS_PARAM,
+        PULSES_PARAM,
+        ROTATE_PARAM,
         NUM_PARAMS
     };
     enum InputIds {
@@ -33,12 +44,17 @@ struct LfsrGenerator : Module {
     NoteGenerator noteGen;
 
     bool running = true;
-    dsp::SchmittTrigger clockTrigger;
+    // Tracks the external clock tempo
+    ClockFollower clockFollower;
+    // Selects which clock ticks play a note
+    RhythmGenerator rhythm;
+    bool restStep = false;
     dsp::SchmittTrigger runningTrigger;
 
     /** Phase of internal LFO */
     float phase = 0.f;
-    float cv_pitch;
+    float cv_pitch[MAX_CHORD_VOICES];
+    unsigned numVoices = 1;
     float cv_level;
 
     const float clkDivInc = 1.f;
@@ -46,7 +62,7 @@ struct LfsrGenerator : Module {
 
 
     LfsrGenerator() :    
-        phase{0.f}, clkDiv{0.f}
+        phase{0.f}, cv_pitch{0.f}, clkDiv{0.f}
     {
         config(NUM_PARAMS, NUM_INPUTS, NUM_OUTPUTS, NUM_LIGHTS);
         configParam(CLOCK_PARAM, -2.f, 6.f, 2.f, "Clock tempo", " bpm", 2.f, 60.f);
@@ -71,6 +87,22 @@ struct LfsrGenerator : Module {
         configParam(LEVELQUANTISE_PARAM, 0.f, 3.f, 0.f, "Level quantize");
         // Level range is Median +/- Range
         //configParam(LEVELRANGE_PARAM, 0.f, 5.f, 5.f, "Level Range");
+
+        // Chord controls: 0 - single note, 1 - triad, 2 - seventh
+        configParam(CHORD_PARAM, 0.f, 2.f, 0.f, "Chord");
+        // Triads clamp at the second inversion
+        configParam(INVERSION_PARAM, 0.f, 3.f, 0.f, "Chord inversion");
+        configParam(SPREAD_PARAM, 0.f, 1.f, 0.f, "Chord spread");
+
+        // External clock multiplication and gate width
+        configParam(CLOCKMULT_PARAM, 1.f, (float)MAX_CLOCK_MULT, 1.f, "Ext clock multiplier", "x");
+        configParam(GATEWIDTH_PARAM, 0.05f, 0.95f, 0.5f, "Ext gate width", "%", 0.f, 100.f);
+
+        // Rhythm controls: 0 - every tick, 1 - Euclidean, 2 - random
+        configParam(RHYTHM_PARAM, 0.f, 2.f, 0.f, "Rhythm");
+        configParam(STEPS_PARAM, 1.f, (float)MAX_RHYTHM_STEPS, 8.f, "Rhythm steps");
+        configParam(PULSES_PARAM, 0.f, (float)MAX_RHYTHM_STEPS, 4.f, "Rhythm pulses");
+        configParam(ROTATE_PARAM, 0.f, (float)(MAX_RHYTHM_STEPS-1), 0.f, "Rhythm rotation");
     }
 
     void process(const ProcessArgs& args) override {
@@ -78,6 +110,9 @@ struct LfsrGenerator : Module {
         if (runningTrigger.process(params[RUN_PARAM].getValue())) {
             running = !running;
             clkDiv = 0.f;
+            clockFollower.reset(inputs[EXCLOC_INPUT].getVoltage());
+            rhythm.reset();
+            restStep = false;
         }
         
         if (running) {
@@ -86,8 +121,10 @@ struct LfsrGenerator : Module {
 
             if (inputs[EXCLOC_INPUT].isConnected()) {
                 // External clock
-                bNewNote = clockTrigger.process(inputs[EXCLOC_INPUT].getVoltage());
-                gateIn = clockTrigger.isHigh();
+                clockFollower.setMultiplier((unsigned)params[CLOCKMULT_PARAM].getValue());
+                clockFollower.setGateWidth(params[GATEWIDTH_PARAM].getValue());
+                bNewNote = clockFollower.process(inputs[EXCLOC_INPUT].getVoltage());
+                gateIn = clockFollower.gate();
             }
             else {
                 // Internal clock
@@ -110,6 +147,20 @@ struct LfsrGenerator : Module {
                     gateIn = (clkDiv < 0.5f);
             }
         
+            // Only rebuilds the pattern if a control has changed
+            rhythm.setPattern(
+                (RhythmGenerator::MODE)params[RHYTHM_PARAM].getValue(),
+                (unsigned)params[STEPS_PARAM].getValue(),
+                (unsigned)params[PULSES_PARAM].getValue(),
+                (unsigned)params[ROTATE_PARAM].getValue());
+
+            if (bNewNote) {
+                // Rest steps keep the last note and hold the gate low
+                restStep = !rhythm.tick();
+                bNewNote = !restStep;
+            }
+            gateIn = gateIn && !restStep;
+
             if (bNewNote) {
                 // if this is a new note generate a new value
 
@@ -117,8 +168,24 @@ struct LfsrGenerator : Module {
                 noteGen.setNoteOffset((unsigned)params[NOTECENTRE_PARAM].getValue());
                 noteGen.setNoteRange((unsigned)params[NOTERANGE_PARAM].getValue());
 
-                unsigned randomNote = noteGen.generatePitch();
-                cv_pitch = (randomNote - 60.0f) / 12.f;
+                unsigned chordType = (unsigned)params[CHORD_PARAM].getValue();
+                if (chordType == 0)
+                {
+                    unsigned randomNote = noteGen.generatePitch();
+                    cv_pitch[0] = (randomNote - 60.0f) / 12.f;
+                    numVoices = 1;
+                }
+                else
+                {
+                    unsigned notes[MAX_CHORD_VOICES];
+                    numVoices = noteGen.generateChord(notes, 
+                        (NoteGenerator::CHORD)(chordType - 1),
+                        (unsigned)params[INVERSION_PARAM].getValue(),
+                        params[SPREAD_PARAM].getValue() > 0.5f);
+
+                    for (unsigned v=0; v<numVoices; v++)
+                        cv_pitch[v] = (notes[v] - 60.0f) / 12.f;
+                }
 
                 float levelQuant = params[LEVELQUANTISE_PARAM].getValue();
 
@@ -135,14 +202,22 @@ struct LfsrGenerator : Module {
             }  
 
             // TODO - manipulate durations by changing the thresholds!
-            outputs[GATE_OUTPUT].setVoltage(gateIn ? 10.f : 0);
-            outputs[CV_PITCH_OUTPUT].setVoltage(cv_pitch);
+            // Pitch and gate are polyphonic, one channel per chord voice
+            outputs[GATE_OUTPUT].setChannels(numVoices);
+            outputs[CV_PITCH_OUTPUT].setChannels(numVoices);
+            for (unsigned v=0; v<numVoices; v++)
+            {
+                outputs[GATE_OUTPUT].setVoltage(gateIn ? 10.f : 0, v);
+                outputs[CV_PITCH_OUTPUT].setVoltage(cv_pitch[v], v);
+            }
             outputs[CV_LEVEL_OUTPUT].setVoltage(cv_level);
 
             lights[RUNNING_LIGHT].setBrightness(1.f);
         }
         else
         {
+            outputs[CV_PITCH_OUTPUT].setChannels(1);
+            outputs[GATE_OUTPUT].setChannels(1);
             outputs[CV_PITCH_OUTPUT].setVoltage(0);
                outputs[GATE_OUTPUT].setVoltage(0);
             outputs[CV_LEVEL_OUTPUT].setVoltage(0);
@@ -197,6 +272,12 @@ struct AccidentalSwitch : CKSSThree, KeyControl<NoteGenerator::ACCIDENTAL> {
     }
 };
 
+struct SnapTrimpot : Trimpot {
+    SnapTrimpot() {
+        snap = true;
+    }
+};
+
 struct LfsrGeneratorWidget : ModuleWidget {
     LfsrGeneratorWidget(LfsrGenerator* module) {
         setModule(module);
@@ -228,6 +309,21 @@ struct LfsrGeneratorWidget : ModuleWidget {
         addParam(createParamCentered<RoundBlackKnob>(mm2px(Vec(36.395, 58.756)), module, LfsrGenerator::NOTERANGE_PARAM));
 
         addParam(createParamCentered<RoundBlackSnapKnob>(mm2px(Vec(14.176, 77.726)), module, LfsrGenerator::LEVELQUANTISE_PARAM));
+        // Chord controls
+        addParam(createParamCentered<SnapTrimpot>(mm2px(Vec(25.4, 77.7)), module, LfsrGenerator::CHORD_PARAM));
+        addParam(createParamCentered<SnapTrimpot>(mm2px(Vec(25.4, 86.6)), module, LfsrGenerator::INVERSION_PARAM));
+        addParam(createParamCentered<CKSS>(mm2px(Vec(25.4, 95.54)), module, LfsrGenerator::SPREAD_PARAM));
+
+        // External clock controls
+        addParam(createParamCentered<SnapTrimpot>(mm2px(Vec(25.4, 104.4)), module, LfsrGenerator::CLOCKMULT_PARAM));
+        addParam(createParamCentered<Trimpot>(mm2px(Vec(25.4, 113.3)), module, LfsrGenerator::GATEWIDTH_PARAM));
+
+        // Rhythm controls
+        addParam(createParamCentered<SnapTrimpot>(mm2px(Vec(6.5, 23.47)), module, LfsrGenerator::RHYTHM_PARAM));
+        addParam(createParamCentered<SnapTrimpot>(mm2px(Vec(15.5, 23.47)), module, LfsrGenerator::STEPS_PARAM));
+        addParam(createParamCentered<SnapTrimpot>(mm2px(Vec(35.3, 23.47)), module, LfsrGenerator::PULSES_PARAM));
+        addParam(createParamCentered<SnapTrimpot>(mm2px(Vec(44.3, 23.47)), module, LfsrGenerator::ROTATE_PARAM));
+
         //addParam(createParamCentered<RoundBlackKnob>(mm2px(Vec(56.688, 58.756)), module, LfsrGenerator::LEVELRANGE_PARAM));
         addOutput(createOutputCentered<PJ301MPort>(mm2px(Vec(36.4, 95.54)), module, LfsrGenerator::CV_LEVEL_OUTPUT));
 
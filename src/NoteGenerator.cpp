@@ -10,16 +10,21 @@ std::unique_ptr<T> make_unique(Args&&... args)
     return std::unique_ptr<T>(new T(std::forward<Args>(args)...));
 }
 
+// With no scale to stack thirds in, chromatic mode uses a major seventh chord
+static const unsigned chromaticChord[MAX_CHORD_VOICES] = {0, 4, 7, 11};
+
 NoteGenerator::NoteGenerator() : 
     noteRange{0x7F}, 
     centreNote{64}, 
     lastNote_{60},
+    staleNotes_{0},
     currentKey{NONE},
     keyBase_{CHROMATIC},
     accidental_{NATURAL},
     mode_{MAJOR}
 {
     assert(std::atomic<KEY>{}.is_lock_free());
+    std::copy(chromaticChord, chromaticChord + MAX_CHORD_VOICES, lastChord_);
 }
 
 static unsigned binarySearch(unsigned *array, unsigned len, unsigned note)
@@ -29,7 +34,7 @@ static unsigned binarySearch(unsigned *array, unsigned len, unsigned note)
     // Set as the wraparound case, in case no matches are found
     unsigned closest = array[len-1];
     int s = 0;
-    int e = len;
+    int e = len - 1;
     while (s <= e)
     {
         int mid = (s + e) / 2;
@@ -119,19 +124,44 @@ void NoteGenerator::updateKey()
 
     // Sort to make all notes in order
     std::sort(workspace, workspace+numNotesInScale);
-    
-    // See https://youtu.be/Q0vrQFyAdWI?t=2663 for how the thread safety is working
+
+    // Chords are stacked in thirds of the parent 7 note scale, so the 
+    // pentatonic modes still get diatonic triads and sevenths.
+    unsigned parentScale[NUM_NOTES_IN_SCALE];
+    for (unsigned i=0; i<NUM_NOTES_IN_SCALE; i++)
     {
-        auto newKeyMap = make_unique<KEYMAP>();
-        std::lock_guard<spin_lock> lock(mutex);
-        for (unsigned i=0; i<NUM_NOTES_CHROMATIC; i++)
+        parentScale[i] = (newKey + keyMapBasisStandard[i]) % 12;
+    }
+    std::sort(parentScale, parentScale+NUM_NOTES_IN_SCALE);
+
+    auto newKeyMap = make_unique<KEYMAP>();
+    for (unsigned i=0; i<NUM_NOTES_CHROMATIC; i++)
+    {
+        // Use a binary search algorithm to fill an array with the nearest value.
+        newKeyMap->data[i] = binarySearch(workspace, numNotesInScale, i);
+
+        // Find the degree of the snapped note in the parent scale
+        unsigned degree = 0;
+        while (degree < NUM_NOTES_IN_SCALE-1 && parentScale[degree] != newKeyMap->data[i])
+            degree++;
+
+        // Stack every other scale note above it, wrapping up an octave
+        for (unsigned v=0; v<MAX_CHORD_VOICES; v++)
         {
-            // Use a binary search algorithm to fill an array with the nearest value.
-            newKeyMap->data[i] = binarySearch(workspace, numNotesInScale, i);
+            unsigned d = degree + 2*v;
+            unsigned note = parentScale[d % NUM_NOTES_IN_SCALE] 
+                + (d / NUM_NOTES_IN_SCALE) * NUM_NOTES_CHROMATIC;
+            newKeyMap->chord[i][v] = note - parentScale[degree];
         }
+    }
+
+    // See https://youtu.be/Q0vrQFyAdWI?t=2663 for how the thread safety is working.
+    // Only hold the lock for the swap so the audio thread rarely misses it.
+    {
+        std::lock_guard<spin_lock> lock(mutex);
         std::swap(keyMap_, newKeyMap);
-        // newKeyMap is deleted once it goes out of scope
     }
+    // newKeyMap (the old map) is deleted once it goes out of scope
 }
 
 
@@ -149,8 +179,8 @@ void NoteGenerator::setNoteRange(unsigned range)
 // Run a linear feedback shift register
 // From https://en.wikipedia.org/wiki/Linear-feedback_shift_register#Galois_LFSRs
 
-// This function is called by the audio thread and therefore must be thread safe.
-unsigned NoteGenerator::generatePitch()
+// Generate a note within the range, before any key snapping
+unsigned NoteGenerator::generateRawPitch()
 {
     // Generate the number in Qx.1 format to get a half.
     // Then round. Not sure it makes a big difference.
@@ -182,8 +212,20 @@ unsigned NoteGenerator::generatePitch()
         noteout = (unsigned)i32note;
     }
 
+    return noteout;
+}
+
+// Snap a note to the current key. If chord is not null it is pointed at the
+// chord row for the note.
+// This function is called by the audio thread and therefore must be thread safe.
+unsigned NoteGenerator::snapPitch(unsigned noteout, const unsigned **chord)
+{
     if (currentKey == NONE)
+    {
+        if (chord != nullptr)
+            *chord = chromaticChord;
         return noteout;
+    }
         
     // snap to a key
     // First get octave and map midiNoteIn to 0 to 11:
@@ -193,17 +235,63 @@ unsigned NoteGenerator::generatePitch()
 
     // Try the lock and returns immediately. 
     // From Real-time 101, part 1 https://www.youtube.com/watch?v=Q0vrQFyAdWI
+    // currentKey is set before the first keyMap_ is built, so check it exists.
     std::unique_lock<spin_lock> tryLock(mutex, std::try_to_lock);
-    if (tryLock.owns_lock())
+    if (tryLock.owns_lock() && keyMap_)
     {
         lastNote_ = (keyMap_->data[basisNote] + octave * NUM_NOTES_CHROMATIC);
+        if (chord != nullptr)
+        {
+            for (unsigned v=0; v<MAX_CHORD_VOICES; v++)
+                lastChord_[v] = keyMap_->chord[basisNote][v];
+        }
+    }
+    else
+    {
+        // If we fail to get a new note, just use the last one. The keyMap_ will be 
+        // updated on the next note.
+        staleNotes_.fetch_add(1, std::memory_order_relaxed);
     }
 
-    // If we fail to get a new note, just use the last one. The keyMap_ will be 
-    // updated on the next note.    
+    if (chord != nullptr)
+        *chord = lastChord_;
     return lastNote_;    
 } 
 
+// This function is called by the audio thread and therefore must be thread safe.
+unsigned NoteGenerator::generatePitch()
+{
+    return snapPitch(generateRawPitch(), nullptr);
+}
+
+// Generate a chord rooted on a new random note. The voicing is read from the 
+// key map, so this is only a few loads more than generatePitch.
+// notes must hold MAX_CHORD_VOICES values. Returns the number of voices written.
+// This function is called by the audio thread and therefore must be thread safe.
+unsigned NoteGenerator::generateChord(unsigned *notes, CHORD type, unsigned inversion, bool spread)
+{
+    unsigned numVoices = (type == SEVENTH) ? 4 : 3;
+    const unsigned *chord;
+    unsigned root = snapPitch(generateRawPitch(), &chord);
+
+    // Inversion raises the lowest voices by an octave. Spread raises the
+    // voice above the bass by another octave for an open voicing.
+    if (inversion > numVoices - 1) inversion = numVoices - 1;
+    unsigned spreadVoice = spread ? (inversion + 1) % numVoices : numVoices;
+    for (unsigned v=0; v<numVoices; v++)
+    {
+        unsigned note = root + chord[v];
+        if (v < inversion) note += NUM_NOTES_CHROMATIC;
+        if (v == spreadVoice) note += NUM_NOTES_CHROMATIC;
+
+        // Keep within MIDI range
+        while (note > 127) note -= NUM_NOTES_CHROMATIC;
+        notes[v] = note;
+    }
+
+    return numVoices;
+}
+
 // Generate a random value between 0 and 127
 unsigned NoteGenerator::generateVelocity()
 {
@@ -7,6 +7,7 @@
 
 #define NUM_NOTES_IN_SCALE 7
 #define NUM_NOTES_CHROMATIC 12
+#define MAX_CHORD_VOICES 4
 
 // From https://youtu.be/Q0vrQFyAdWI?t=2663
 // A bit crude but probably fine for this simple plugin...
@@ -89,17 +90,31 @@ public:
         PENTATONIC_MAJ
     } MODE;
 
+    typedef enum
+    {
+        TRIAD=0,
+        SEVENTH,
+        NUM_CHORD_TYPES
+    } CHORD;
+
 private:
 	LFSR lfsr;
     unsigned noteRange;
     unsigned centreNote;
     unsigned lastNote_;
+    // Offsets of the last chord, reused if the key map lock fails
+    unsigned lastChord_[MAX_CHORD_VOICES];
+    // Number of times the last note was reused because the key map was busy
+    std::atomic<unsigned> staleNotes_;
 
     // DANGER! these are used in the audio thread and updated in the GUI
     // by updateKey. See https://youtu.be/Q0vrQFyAdWI?t=2663
     spin_lock mutex;
     struct KEYMAP {
 	    unsigned data[NUM_NOTES_CHROMATIC];
+        // Semitone offsets from the snapped root for root, 3rd, 5th and 7th,
+        // stacked in thirds within the parent 7 note scale.
+        unsigned chord[NUM_NOTES_CHROMATIC][MAX_CHORD_VOICES];
     };
     std::unique_ptr<KEYMAP> keyMap_;
 	std::atomic<KEY> currentKey;
@@ -122,5 +137,12 @@ public:
     void setNoteRange(unsigned range);
 
 	unsigned generatePitch();
+    unsigned generateChord(unsigned *notes, CHORD type, unsigned inversion, bool spread);
     unsigned generateVelocity();
+
+    unsigned staleNoteCount() const { return staleNotes_.load(std::memory_order_relaxed); }
+
+private:
+    unsigned generateRawPitch();
+    unsigned snapPitch(unsigned noteout, const unsigned **chord);
 };
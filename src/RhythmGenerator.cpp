@@ -0,0 +1,91 @@
+#include "RhythmGenerator.hpp"
+
+
+RhythmGenerator::RhythmGenerator() :
+    mode_{OFF},
+    steps_{1},
+    pulses_{1},
+    rotation_{0},
+    step_{0}
+{
+    roll();
+    rebuild();
+}
+
+void RhythmGenerator::roll()
+{
+    for (unsigned i=0; i<MAX_RHYTHM_STEPS; i++)
+        rolls_[i] = lfsr.generate();
+}
+
+void RhythmGenerator::reset()
+{
+    step_ = 0;
+    roll();
+    rebuild();
+}
+
+void RhythmGenerator::setPattern(MODE mode, unsigned steps, unsigned pulses, unsigned rotation)
+{
+    steps = steps < 1 ? 1 : (steps > MAX_RHYTHM_STEPS ? MAX_RHYTHM_STEPS : steps);
+    pulses = pulses > steps ? steps : pulses;
+    rotation %= steps;
+
+    if (mode == mode_ && steps == steps_ && pulses == pulses_ && rotation == rotation_)
+        return;
+
+    mode_ = mode;
+    steps_ = steps;
+    pulses_ = pulses;
+    rotation_ = rotation;
+    rebuild();
+}
+
+// Generate a new mask from the controls. Bit 0 is the first step.
+void RhythmGenerator::rebuild()
+{
+    uint64_t all = (steps_ == MAX_RHYTHM_STEPS) ? ~(uint64_t)0 : (((uint64_t)1 << steps_) - 1);
+    uint64_t mask = 0;
+
+    switch (mode_)
+    {
+    case OFF:
+        // Every step plays
+        mask = all;
+        break;
+
+    case EUCLIDEAN:
+        // Bresenham style, see https://en.wikipedia.org/wiki/Euclidean_rhythm
+        for (unsigned i=0; i<steps_; i++)
+        {
+            if ((i * pulses_) % steps_ < pulses_)
+                mask |= (uint64_t)1 << i;
+        }
+        break;
+
+    case RANDOM:
+        // Each step plays with a probability of pulses/steps
+        {
+            unsigned threshold = (pulses_ << 16) / steps_;
+            for (unsigned i=0; i<steps_; i++)
+            {
+                if (rolls_[i] < threshold)
+                    mask |= (uint64_t)1 << i;
+            }
+        }
+        break;
+
+    default:
+        break;
+    }
+
+    // Rotate within the pattern length
+    if (rotation_ > 0)
+        mask = ((mask >> rotation_) | (mask << (steps_ - rotation_))) & all;
+
+    // Stay on the same step so the rhythm keeps its place in the bar
+    step_ %= steps_;
+    current_ = mask;
+    if (step_ > 0)
+        current_ = ((mask >> step_) | (mask << (steps_ - step_))) & all;
+}
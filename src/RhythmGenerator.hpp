@@ -0,0 +1,59 @@
+#pragma once
+#include "NoteGenerator.hpp"
+#include <cstdint>
+
+
+#define MAX_RHYTHM_STEPS 64
+
+// Decides which clock ticks play a note. The pattern is precomputed into a 
+// 64 bit mask when the controls change, so each tick is a bit test and a 
+// rotate.
+class RhythmGenerator
+{
+public:
+    typedef enum
+    {
+        OFF=0,
+        EUCLIDEAN,
+        RANDOM,
+        NUM_RHYTHM_MODES
+    } MODE;
+
+private:
+	LFSR lfsr;
+
+    // Current controls, used to detect changes
+    MODE mode_;
+    unsigned steps_;
+    unsigned pulses_;
+    unsigned rotation_;
+
+    // Random values for each step, so RANDOM patterns only change when
+    // the density does and not on every control change
+    uint16_t rolls_[MAX_RHYTHM_STEPS];
+
+    uint64_t current_;    // pattern rotated to the current step
+    unsigned step_;       // next step to play
+
+    void roll();
+    void rebuild();
+
+public:
+    RhythmGenerator();
+
+    // Restart the pattern from the first step, with new random values
+    void reset();
+
+    // Cheap to call every sample, the mask is only rebuilt on a change.
+    // The pattern carries on from the current step.
+    void setPattern(MODE mode, unsigned steps, unsigned pulses, unsigned rotation);
+
+    // Call on every clock tick. Returns true if the step plays a note.
+    bool tick()
+    {
+        uint64_t on = current_ & 1u;
+        current_ = (current_ >> 1) | (on << (steps_ - 1));
+        step_ = (step_ + 1 == steps_) ? 0 : step_ + 1;
+        return on != 0;
+    }
+};
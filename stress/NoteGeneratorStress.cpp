@@ -0,0 +1,215 @@
+// Stress test for NoteGenerator key changes.
+//
+// Several threads hammer updateKey(...) while a real-time priority thread
+// calls generatePitch and/or generateChord at audio rate. Reports the number 
+// of stale notes (the try lock failed and the last note was reused) and the 
+// latency distribution of each call, so the locking can be judged by its 
+// tail latency.
+//
+// Build with `make stress` (ThreadSanitizer by default), or
+// `make stress STRESS_SANITIZE=` for realistic latencies.
+//
+// Usage: NoteGeneratorStress [seconds] [updater threads] [sample rate] [pitch|chord|both]
+
+#include "NoteGenerator.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <pthread.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+typedef std::chrono::steady_clock Clock;
+
+// Samples processed between sleeps, like an audio callback
+#define BLOCK_SIZE 64
+
+// Which audio thread calls to make
+typedef enum
+{
+    PITCH=0,
+    CHORD,
+    BOTH
+} CALLS;
+
+static std::atomic<bool> done{false};
+
+// updateKey is only ever called from Rack's GUI thread. The updaters model
+// several UI sources funnelled into that thread, so they take turns.
+static std::mutex guiMutex;
+
+static void updater(NoteGenerator *noteGen, unsigned seed, unsigned long *count)
+{
+    unsigned long n = 0;
+    while (!done.load(std::memory_order_relaxed))
+    {
+        seed = seed * 1664525u + 1013904223u;
+        unsigned r = seed >> 16;
+
+        std::lock_guard<std::mutex> lock(guiMutex);
+        switch (r % 3)
+        {
+        case 0:
+            noteGen->updateKey((NoteGenerator::KEY_BASE)((r >> 2) % NoteGenerator::NUM_BASE_KEYS));
+            break;
+        case 1:
+            noteGen->updateKey((NoteGenerator::MODE)((r >> 2) % 4));
+            break;
+        case 2:
+            noteGen->updateKey((NoteGenerator::ACCIDENTAL)((int)((r >> 2) % 3) - 1));
+            break;
+        }
+        n++;
+    }
+    *count = n;
+}
+
+static uint32_t elapsedNs(Clock::time_point start, Clock::time_point end)
+{
+    return (uint32_t)std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+}
+
+static void audio(NoteGenerator *noteGen, double sampleRate, CALLS calls, size_t numSamples,
+    std::vector<uint32_t> *pitchLatencies, std::vector<uint32_t> *chordLatencies)
+{
+    sched_param sp;
+    sp.sched_priority = sched_get_priority_max(SCHED_FIFO);
+    if (pthread_setschedparam(pthread_self(), SCHED_FIFO, &sp) != 0)
+        printf("Warning: could not set SCHED_FIFO, running at normal priority\n");
+
+    auto blockTime = std::chrono::duration_cast<Clock::duration>(
+        std::chrono::duration<double>(BLOCK_SIZE / sampleRate));
+    auto deadline = Clock::now();
+    unsigned sink = 0;
+    unsigned notes[MAX_CHORD_VOICES];
+
+    for (size_t n=0; n + BLOCK_SIZE <= numSamples; n += BLOCK_SIZE)
+    {
+        for (unsigned i=0; i<BLOCK_SIZE; i++)
+        {
+            // BOTH alternates between the two calls
+            bool chord = (calls == CHORD) || (calls == BOTH && (i & 1));
+            if (chord)
+            {
+                // Cycle through the chord settings as the module would
+                auto start = Clock::now();
+                sink += noteGen->generateChord(notes, 
+                    (NoteGenerator::CHORD)(i % NoteGenerator::NUM_CHORD_TYPES), i % 4, i & 2);
+                auto end = Clock::now();
+                chordLatencies->push_back(elapsedNs(start, end));
+                sink += notes[0];
+            }
+            else
+            {
+                auto start = Clock::now();
+                sink += noteGen->generatePitch();
+                auto end = Clock::now();
+                pitchLatencies->push_back(elapsedNs(start, end));
+            }
+        }
+
+        deadline += blockTime;
+        std::this_thread::sleep_until(deadline);
+    }
+
+    // Keep the calls from being optimised away
+    if (sink == 0)
+        printf("\n");
+}
+
+static uint32_t percentile(const std::vector<uint32_t> &sorted, double p)
+{
+    size_t i = (size_t)(p * (sorted.size() - 1));
+    return sorted[i];
+}
+
+static void report(const char *name, std::vector<uint32_t> &latencies)
+{
+    if (latencies.empty())
+        return;
+
+    std::sort(latencies.begin(), latencies.end());
+
+    printf("%s calls: %zu\n", name, latencies.size());
+    printf("  latency p50:   %u ns\n", percentile(latencies, 0.5));
+    printf("  latency p99:   %u ns\n", percentile(latencies, 0.99));
+    printf("  latency p99.9: %u ns\n", percentile(latencies, 0.999));
+    printf("  latency max:   %u ns\n", latencies.back());
+}
+
+int main(int argc, char **argv)
+{
+    double seconds = argc > 1 ? atof(argv[1]) : 10.0;
+    unsigned numUpdaters = argc > 2 ? (unsigned)atoi(argv[2]) : 4;
+    double sampleRate = argc > 3 ? atof(argv[3]) : 48000.0;
+    std::string callsArg = argc > 4 ? argv[4] : "pitch";
+
+    CALLS calls = PITCH;
+    if (callsArg == "pitch")
+        calls = PITCH;
+    else if (callsArg == "chord")
+        calls = CHORD;
+    else if (callsArg == "both")
+        calls = BOTH;
+    else
+        seconds = 0;
+
+    if (seconds <= 0 || numUpdaters == 0 || sampleRate <= 0)
+    {
+        fprintf(stderr, "Usage: %s [seconds] [updater threads] [sample rate] [pitch|chord|both]\n", argv[0]);
+        return 1;
+    }
+
+    printf("%.1f s at %.0f Hz with %u updater threads, %s calls\n", 
+        seconds, sampleRate, numUpdaters, callsArg.c_str());
+
+    NoteGenerator noteGen;
+
+    // Preallocate so the audio thread never allocates
+    size_t numSamples = (size_t)(seconds * sampleRate);
+    std::vector<uint32_t> pitchLatencies;
+    std::vector<uint32_t> chordLatencies;
+    if (calls != CHORD)
+        pitchLatencies.reserve(numSamples);
+    if (calls != PITCH)
+        chordLatencies.reserve(numSamples);
+
+    std::vector<unsigned long> updateCounts(numUpdaters);
+    std::vector<std::thread> updaters;
+    for (unsigned i=0; i<numUpdaters; i++)
+        updaters.emplace_back(updater, &noteGen, i + 1, &updateCounts[i]);
+
+    std::thread audioThread(audio, &noteGen, sampleRate, calls, numSamples, 
+        &pitchLatencies, &chordLatencies);
+    audioThread.join();
+
+    done = true;
+    for (auto &t : updaters)
+        t.join();
+
+    unsigned long updates = 0;
+    for (auto c : updateCounts)
+        updates += c;
+
+    size_t total = pitchLatencies.size() + chordLatencies.size();
+    if (total == 0)
+    {
+        fprintf(stderr, "No samples generated\n");
+        return 1;
+    }
+
+    // Both calls share the stale note count
+    unsigned stale = noteGen.staleNoteCount();
+
+    printf("updateKey calls: %lu\n", updates);
+    printf("stale notes: %u of %zu (%.4f%%)\n", stale, total, 100.0 * stale / total);
+    report("generatePitch", pitchLatencies);
+    report("generateChord", chordLatencies);
+
+    return 0;
+}